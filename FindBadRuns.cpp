@@ -8,52 +8,155 @@
  */
 
 #include <iostream>
+#include <fstream>
 #include <math.h>
 #include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <TFile.h>
 #include <TProfile.h>
 #include <TGraph.h>
+#include <TGraphErrors.h>
+#include <TCanvas.h>
+#include <TLegend.h>
+#include <TMath.h>
+#include <TMatrixD.h>
+
+// All run QA profiles of one file as a runs x observables matrix. Every
+// observable is a contiguous column of nRuns values. Only runs that
+// have entries in at least one profile get a row.
+struct RunQAMatrix {
+	std::vector<std::string> mNames;      // profile of every column
+	std::vector<Int_t> mRunIds;           // run number of every row
+	std::vector<Double_t> mContent;       // [iObs * nRuns + iRun]
+	std::vector<Double_t> mError;
+
+	Int_t NRuns() const { return mRunIds.size(); }
+	Int_t NObs() const { return mNames.size(); }
+};
+
+// Mean and standard deviation of the bin contents and bin errors of one
+// observable over the runs that were not rejected
+struct RunQAStats {
+	Int_t mNRuns;
+	Int_t mNIterations;
+	Double_t mMeanContent, mMeanError;
+	Double_t mSigmaContent, mSigmaError;
+};
 
 Float_t RoundValue( Double_t value );
 
-std::vector<int> GetBadRuns( TFile *f, const Char_t *tprofile, std::vector<Int_t> BadRuns,
-									   const Char_t *inFileRunQA, const Char_t *energy, 
-									   const Char_t *pathPics, const Char_t *format);
+Bool_t ReadRunQAMatrix( TFile *f, RunQAMatrix &matrix );
+Bool_t ReadRunQARecords( TFile *f, RunQAMatrix &matrix );
 
+void FlagBadRuns( const RunQAMatrix *matrix, Int_t firstObs, Int_t stepObs, Int_t nIterations,
+				  std::vector<RunQAStats> *stats, std::vector<UChar_t> *flags );
 
+void DrawBadRuns( TProfile *tp, TProfile *tp1, const RunQAMatrix &matrix, Int_t iObs,
+				  const RunQAStats &stats, const std::vector<UChar_t> &flags,
+				  const Char_t *pathPics, const Char_t *format );
+
+
+// nThreads - number of threads to evaluate the observables in, 1 (the
+//            default) evaluates them sequentially, 0 means one per core
+// nIterations - the 3 sigma rejection is repeated, with the mean and sigma
+//               recomputed without the rejected runs, until no new run is
+//               rejected or nIterations is reached. 1 is a single pass.
 void FindBadRuns(const Char_t *inFileNoRunQA = "QAtest14gev.root",
 			 	 const Char_t *inFileRunQA = "",
 			     const Char_t *energy = "14gev",
 			     const Char_t *pathPics = "",
-			     const Char_t *format = "") {
+			     const Char_t *format = "",
+			     const Char_t *outBadRunsList = "",
+			     Int_t nThreads = 1,
+			     Int_t nIterations = 1) {
+
+	std::cout << "Looking for bad runs at " << energy << std::endl;
 
+	// Read stage: every profile once
 	TFile *f1 = new TFile(inFileNoRunQA,"READ");
-	std::vector<Int_t> BadRunList;
-	
-	for(Int_t i = 0; i < 10; i++) {
-		BadRunList = GetBadRuns(f1, Form("hEventProfile_%i",i), BadRunList, inFileRunQA,energy,pathPics,format);
-		if( i < 6 ) {
-			BadRunList = GetBadRuns(f1, Form("hTrackProfile_%i",i), BadRunList, inFileRunQA,energy,pathPics,format);
+	RunQAMatrix matrix;
+	if( !ReadRunQAMatrix( f1, matrix ) ) {
+		std::cout << "No run QA profiles in " << inFileNoRunQA << std::endl;
+		return;
+	}
+	std::cout << "Read " << matrix.NObs() << " profiles of " << matrix.NRuns() << " runs" << std::endl;
+
+	// Statistics stage: observables are independent, split them over threads
+	if( nThreads <= 0 ) nThreads = std::thread::hardware_concurrency();
+	nThreads = TMath::Max( 1, TMath::Min( nThreads, matrix.NObs() ) );
+	std::vector<RunQAStats> stats( matrix.NObs() );
+	std::vector<UChar_t> flags( matrix.mContent.size(), 0 );
+	if( nThreads == 1 ) {
+		FlagBadRuns( &matrix, 0, 1, nIterations, &stats, &flags );
+	}
+	else {
+		std::vector<std::thread> workers;
+		for( Int_t iThread = 0; iThread < nThreads; iThread++ ) {
+			workers.push_back( std::thread( FlagBadRuns, &matrix, iThread, nThreads, nIterations, &stats, &flags ) );
 		}
-		if( i < 3) {
-			BadRunList = GetBadRuns(f1, Form("hSinPhi%i",i+1), BadRunList, inFileRunQA,energy,pathPics,format);
-			BadRunList = GetBadRuns(f1, Form("hCosPhi%i",i+1), BadRunList, inFileRunQA,energy,pathPics,format);
+		for( Int_t iThread = 0; iThread < nThreads; iThread++ ) workers[iThread].join();
+	}
+
+	Int_t nRuns = matrix.NRuns();
+	std::vector<Int_t> BadRunList;
+	for( Int_t iRun = 0; iRun < nRuns; iRun++ ) {
+		for( Int_t iObs = 0; iObs < matrix.NObs(); iObs++ ) {
+			if( flags[iObs * nRuns + iRun] ) {
+				BadRunList.push_back( matrix.mRunIds[iRun] );
+				break;
+			}
 		}
 	}
+	for( Int_t iObs = 0; iObs < matrix.NObs(); iObs++ ) {
+		Int_t nBad = 0;
+		for( Int_t iRun = 0; iRun < nRuns; iRun++ ) nBad += flags[iObs * nRuns + iRun];
+		std::cout << matrix.mNames[iObs] << ": " << nBad << " bad of " << stats[iObs].mNRuns + nBad
+		     << " runs after " << stats[iObs].mNIterations << " iteration(s)" << std::endl;
+	}
 
-	if( strncmp(inFileRunQA,"",1) == 0 ) {
+	// Optional drawing stage
+	if( strncmp(inFileRunQA,"",1) != 0 ) {
+		TFile *f2 = new TFile(inFileRunQA,"READ");
+		for( Int_t iObs = 0; iObs < matrix.NObs(); iObs++ ) {
+			const Char_t *name = matrix.mNames[iObs].c_str();
+			TProfile *tp = (TProfile*) f1 -> Get( name );
+			TProfile *tp1 = (TProfile*) f2 -> Get( name );
+			if( !tp1 ) {
+				std::cout << "No " << name << " in " << inFileRunQA << std::endl;
+				continue;
+			}
+			DrawBadRuns( tp, tp1, matrix, iObs, stats[iObs], flags, pathPics, format );
+		}
+		f2 -> Close();
+	}
+	else {
 
 		std::sort(BadRunList.begin(), BadRunList.end() );
-		BadRunList.erase( unique( BadRunList.begin(), BadRunList.end() ), BadRunList.end() );
+		BadRunList.erase( std::unique( BadRunList.begin(), BadRunList.end() ), BadRunList.end() );
 
-		for(Int_t i = 0; i < BadRunList.size(); i++) {
-			if( i != 0 && i%5 == 0 ) cout << "\n";
-			cout << BadRunList[i];
-			if( i < BadRunList.size() - 1) cout << ",";
+		for(size_t i = 0; i < BadRunList.size(); i++) {
+			if( i != 0 && i%5 == 0 ) std::cout << "\n";
+			std::cout << BadRunList[i];
+			if( i < BadRunList.size() - 1) std::cout << ",";
+		}
+		std::cout << std::endl;
+
+		if( strncmp(outBadRunsList,"",1) != 0 ) { // input for FemtoDstQA( ..., badRunsFile )
+			std::ofstream outList(outBadRunsList);
+			for(size_t i = 0; i < BadRunList.size(); i++) {
+				if( i != 0 && i%5 == 0 ) outList << "\n";
+				outList << BadRunList[i];
+				if( i < BadRunList.size() - 1) outList << ",";
+			}
+			outList << std::endl;
+			std::cout << "Bad runs are written to " << outBadRunsList << std::endl;
 		}
-		cout << endl;
 	}
-	
 
+	f1 -> Close();
 }
 
 Float_t RoundValue( Double_t value ) {
@@ -74,179 +177,254 @@ Float_t RoundValue( Double_t value ) {
 	return value;
 }
 
-std::vector<int> GetBadRuns(TFile *f, const Char_t *tprofile, std::vector<Int_t> BadRuns, 
-									  const Char_t *inFileRunQA, const Char_t *energy, 
-									  const Char_t *pathPics, const Char_t *format) {
-	cout << "Working on " << tprofile << endl;
-	Int_t runIdBins;
-  	Int_t runIdRange[2];
-
-  	if( strncmp(energy, "39gev",5) == 0) {
-	    runIdRange[0] = 11095000;
-	    runIdRange[1] = 11115000;
-	    runIdBins = runIdRange[1] - runIdRange[0];
-  	}// if( strncmp(energy, "39GeV",5) == 0 )
-
-  	if( strncmp(energy, "27gev",5) == 0 ){
-	    runIdRange[0] = 12171000;
-	    runIdRange[1] = 12180000;
-	    runIdBins = runIdRange[1] - runIdRange[0];
-	}// if( strncmp( energy, "27GeV",5) == 0 )
-
-	if( strncmp(energy, "19GeV",5) == 0) {
-	    runIdRange[0] = 12110000;
-	    runIdRange[1] = 12123000;
-	    runIdBins = runIdRange[1] - runIdRange[0];
-  	}// if( strncmp(energy, "19GeV",5) == 0 )
-
-	if( strncmp(energy, "14gev",5) == 0 ) {
-	    runIdRange[0] = 15045000;
-	    runIdRange[1] = 15075000;
-	    runIdBins = runIdRange[1] - runIdRange[0];
-  	}// if( strncmp(energy, "14GeV",5) == 0)
-
-  	if( strncmp(energy, "11GeV",5) == 0 ) {
-	    runIdRange[0] = 11145000;
-	    runIdRange[1] = 11165000;
-	    runIdBins = runIdRange[1] - runIdRange[0];
-    }// if( strncmp(energy, "11GeV",5) == 0 )
-
-    if(strncmp(energy, "7GeV",4)==0){
-	    runIdRange[0] = 11110000;
-	    runIdRange[1] = 11150000;
-	    runIdBins = runIdRange[1] - runIdRange[0];
-  	}// if(strncmp(energy, "7GeV",4)==0)
-
-  TProfile *tp = (TProfile*)f -> Get( tprofile );
-	std::vector<Float_t> VbinContent , VbinError;
-	Float_t binContent = 0, binError = 0;
-	Float_t Mcontent = 0, Merror = 0, Scontent = 0, Serror = 0;
-	Float_t Sc = 0, Serr = 0, sigmaC, sigmaErr; 
-	Int_t n = 0, k = 0;
-
-	for( Int_t bin = 1; bin <= runIdBins; bin++ ) { //get content and error from TProfile and calc mean
-		binContent  = tp -> GetBinContent(bin);
-		binError = tp -> GetBinError(bin);
-		if( binContent  == 0 || binError == 0 ) continue;
-		VbinContent.push_back(binContent);
-		VbinError.push_back(binError);
-		Scontent  += binContent ;
-		Serror += binError; 
-		n++;
-	}
-	Mcontent  = Scontent/n;
-	Merror = Serror/n;
-
-	for( Int_t i = 0; i < VbinContent.size(); i++ ) { // root mean square
-		Sc += VbinContent[i]*VbinContent[i] - Mcontent*Mcontent;
-		Serr += VbinError[i]*VbinError[i] - Merror*Merror;
-	} 
-
-	Sc = Sc/(n-1);
-	Serr = Serr/(n-1);
-	sigmaC = sqrt(Sc);     //sigma content 
-	sigmaErr = sqrt(Serr); //sigma error
-
-	k = 0;
-	Int_t b = 0;
-	for( Int_t bin = 1; bin <= runIdBins; bin++ ) { //bad nambers Run on desktop 
-		binContent  = tp -> GetBinContent(bin);
-		binError = tp -> GetBinError(bin);
-		k++;
-		if( binContent  == 0 || binError == 0 ) continue;
-		if ( TMath::Abs( binContent - Mcontent ) > 3*sigmaC || TMath::Abs( binError - Merror ) > 3*sigmaErr ) {
-			BadRuns.push_back( bin + runIdRange[0] - 1 );
-			b++;
+// Fill the matrix from hEventProfile_*, hTrackProfile_*, hSinPhi* and
+// hCosPhi*. The run number of a bin is its low edge, so the run range
+// is taken from the profiles and not from the energy. Files written by
+// the current FemtoDstQA also have the per-run records, those are read
+// instead and no profile bin is visited.
+Bool_t ReadRunQAMatrix( TFile *f, RunQAMatrix &matrix ) {
+
+	for( Int_t i = 0; i < 10; i++ ) matrix.mNames.push_back( Form("hEventProfile_%i",i) );
+	for( Int_t i = 0; i < 6; i++ ) matrix.mNames.push_back( Form("hTrackProfile_%i",i) );
+	for( Int_t i = 0; i < 3; i++ ) matrix.mNames.push_back( Form("hSinPhi%i",i+1) );
+	for( Int_t i = 0; i < 3; i++ ) matrix.mNames.push_back( Form("hCosPhi%i",i+1) );
+	if( ReadRunQARecords( f, matrix ) ) return true;
+
+	std::vector<TProfile*> profiles;
+
+	std::vector<std::string> names;
+	for( UInt_t iObs = 0; iObs < matrix.mNames.size(); iObs++ ) {
+		TProfile *tp = (TProfile*)f -> Get( matrix.mNames[iObs].c_str() );
+		if( !tp ) {
+			std::cout << "No " << matrix.mNames[iObs] << ", skipping it" << std::endl;
+			continue;
 		}
+		names.push_back( matrix.mNames[iObs] );
+		profiles.push_back( tp );
 	}
-	
-	Float_t badRun[b];             // arrays for graphics
-	Float_t badContent[b];
-	Float_t badCErr[b], badRErr[b];
-
-	k =0;
-	b = 0;
-	for( Int_t bin = 1; bin <= runIdBins; bin++ ) {       //record Bad Run in array for graph 
-		binContent  = tp -> GetBinContent(bin);
-		binError = tp -> GetBinError(bin);
-		k++;
-		if( binContent  == 0 || binError == 0 ) continue;
-		if ( TMath::Abs( binContent - Mcontent ) > 3*sigmaC || TMath::Abs( binError - Merror ) > 3*sigmaErr ) {
-			badRun[b] = bin + runIdRange[0] - 1;
-			badContent[b] = binContent;
-			badCErr[b] = binError;
-			badRErr[b] = 0;
-			b++;
+	matrix.mNames = names;
+	if( profiles.empty() ) return false;
+
+	// Rows: runs with entries in any profile, in ascending order
+	std::map<Int_t, Int_t> rows;
+	for( UInt_t iObs = 0; iObs < profiles.size(); iObs++ ) {
+		TProfile *tp = profiles[iObs];
+		for( Int_t bin = 1; bin <= tp -> GetNbinsX(); bin++ ) {
+			if( tp -> GetBinEntries(bin) == 0 ) continue;
+			rows[ TMath::Nint( tp -> GetBinLowEdge(bin) ) ] = 0;
 		}
 	}
+	for( std::map<Int_t, Int_t>::iterator it = rows.begin(); it != rows.end(); ++it ) {
+		it -> second = matrix.mRunIds.size();
+		matrix.mRunIds.push_back( it -> first );
+	}
 
-	if( strncmp(inFileRunQA,"",1) != 0 ) {
+	Int_t nRuns = matrix.NRuns();
+	matrix.mContent.assign( profiles.size() * nRuns, 0. );
+	matrix.mError.assign( profiles.size() * nRuns, 0. );
+	for( UInt_t iObs = 0; iObs < profiles.size(); iObs++ ) {
+		TProfile *tp = profiles[iObs];
+		Double_t *content = &matrix.mContent[iObs * nRuns];
+		Double_t *error = &matrix.mError[iObs * nRuns];
+		for( Int_t bin = 1; bin <= tp -> GetNbinsX(); bin++ ) {
+			if( tp -> GetBinEntries(bin) == 0 ) continue;
+			Int_t iRun = rows[ TMath::Nint( tp -> GetBinLowEdge(bin) ) ];
+			content[iRun] = tp -> GetBinContent(bin);
+			error[iRun] = tp -> GetBinError(bin);
+		}
+	}
+	return true;
+}
 
-		TCanvas *c1 = new TCanvas("c1", "c1", 1366, 768);
-  		c1->Divide(2);
-  		c1 -> cd(1);
-
-		tp -> SetStats(0);
-		tp -> SetMarkerStyle(20); 
-		tp -> SetMarkerColor(kBlack); 
-		tp -> SetAxisRange(Mcontent - 15*sigmaC,Mcontent + 15*sigmaC,"Y");
-		tp -> Draw();
-
-		TLegend *legC2_1 = new TLegend(0.54,0.7,0.89,.89);
-	    legC2_1->AddEntry(tp,Form("Mean = %f",RoundValue(Mcontent) ),"");
-	    legC2_1->AddEntry(tp,Form("Mean error = %f",RoundValue(Merror) ),"");    
-	    legC2_1->AddEntry(tp,Form("Sigma = %f", RoundValue(sigmaC) ),"");
-	    legC2_1->AddEntry(tp,Form("Sigma error = %f", RoundValue(sigmaErr) ),"");
-	    legC2_1->SetFillColor(kWhite);
-	    legC2_1->SetBorderSize(0); 
-	    legC2_1->Draw();
-		
-		Float_t x[2], mean[2]; 
-		x[0] = runIdRange[0] - 1000, x[1] = runIdRange[1] + 1000;
-		mean[0] = Mcontent, mean[1] = Mcontent;
-		TGraph *gmean = new TGraph(2,x,mean);  //paint calculated mean
-		gmean -> SetLineColor(kRed);
-		gmean -> SetLineWidth(2);
-		gmean -> Draw("CPsame");
-		
-		Float_t sigmapos[2];
-		sigmapos[0] = Mcontent + 3*sigmaC, sigmapos[1] = Mcontent + 3*sigmaC;
-		TGraph *gsigmapos = new TGraph(2,x,sigmapos);  //paint top sigma 
-		gsigmapos -> SetLineColor(kRed);
-		gsigmapos -> SetLineStyle(9);
-		gsigmapos -> SetLineWidth(2);
-		gsigmapos -> Draw("CPsame");
-		
-		Float_t sigmaneg[2];
-		sigmaneg[0] = Mcontent - 3*sigmaC, sigmaneg[1] = Mcontent - 3*sigmaC;
-		TGraph *gsigmaneg = new TGraph(2,x,sigmaneg);  //paint down sigma 
-		gsigmaneg -> SetLineColor(kRed);
-		gsigmaneg -> SetLineStyle(9);
-		gsigmaneg-> SetLineWidth(2);
-		gsigmaneg -> Draw("CPsame");
-		
-		TGraphErrors* gbaddot = new TGraphErrors(b,badRun,badContent,badRErr,badCErr); //paint red dot for visualisation
-		gbaddot -> SetMarkerStyle(20); 
+// runQARecords of FemtoDstQA: one row per run with the run number, the
+// number of events and sum of weights, sum and sum of squares of every
+// observable, in the order of matrix.mNames. Bin content and error are
+// the ones the run's profile bin would have.
+Bool_t ReadRunQARecords( TFile *f, RunQAMatrix &matrix ) {
+
+	TMatrixD *records = (TMatrixD*)f -> Get( "runQARecords" );
+	Int_t nObs = matrix.NObs();
+	if( !records || records -> GetNcols() != 2 + 3 * nObs ) return false;
+
+	// Rows: runs with entries in any observable, in ascending order
+	std::map<Int_t, Int_t> rows;
+	for( Int_t iRec = 0; iRec < records -> GetNrows(); iRec++ ) {
+		for( Int_t iObs = 0; iObs < nObs; iObs++ ) {
+			if( (*records)(iRec, 2 + 3 * iObs) == 0 ) continue;
+			rows[ TMath::Nint( (*records)(iRec, 0) ) ] = iRec;
+			break;
+		}
+	}
+
+	Int_t nRuns = rows.size();
+	matrix.mContent.assign( nObs * nRuns, 0. );
+	matrix.mError.assign( nObs * nRuns, 0. );
+	for( std::map<Int_t, Int_t>::iterator it = rows.begin(); it != rows.end(); ++it ) {
+		Int_t iRun = matrix.mRunIds.size();
+		Int_t iRec = it -> second;
+		matrix.mRunIds.push_back( it -> first );
+		for( Int_t iObs = 0; iObs < nObs; iObs++ ) {
+			Double_t sumW = (*records)(iRec, 2 + 3 * iObs);
+			if( sumW == 0 ) continue;
+			Double_t mean = (*records)(iRec, 3 + 3 * iObs) / sumW;
+			Double_t meanY2 = (*records)(iRec, 4 + 3 * iObs) / sumW;
+			matrix.mContent[iObs * nRuns + iRun] = mean;
+			matrix.mError[iObs * nRuns + iRun] = sqrt( TMath::Abs( meanY2 - mean * mean ) / sumW );
+		}
+	}
+	delete records;
+	std::cout << "Run QA is read from the runQARecords table" << std::endl;
+	return true;
+}
+
+// Flag the runs whose bin content or bin error is more than 3 sigma away
+// from the mean of observables firstObs, firstObs + stepObs, ... Runs with
+// zero content or error are not used, as before. Each call writes only
+// its own columns of stats and flags, so calls can run in parallel.
+void FlagBadRuns( const RunQAMatrix *matrix, Int_t firstObs, Int_t stepObs, Int_t nIterations,
+				  std::vector<RunQAStats> *stats, std::vector<UChar_t> *flags ) {
+
+	Int_t nRuns = matrix -> NRuns();
+	std::vector<UChar_t> used( nRuns );
+
+	for( Int_t iObs = firstObs; iObs < matrix -> NObs(); iObs += stepObs ) {
+		const Double_t *content = &matrix -> mContent[iObs * nRuns];
+		const Double_t *error = &matrix -> mError[iObs * nRuns];
+		UChar_t *isBad = &(*flags)[iObs * nRuns];
+		RunQAStats &s = (*stats)[iObs];
+
+		for( Int_t iRun = 0; iRun < nRuns; iRun++ ) {
+			used[iRun] = ( content[iRun] != 0 && error[iRun] != 0 );
+		}
+
+		s.mNIterations = 0;
+		for( Int_t iter = 0; iter < TMath::Max( nIterations, 1 ); iter++ ) {
+			// Two passes: the means, then the squared deviations from them
+			Int_t n = 0;
+			Double_t sumContent = 0, sumError = 0;
+			for( Int_t iRun = 0; iRun < nRuns; iRun++ ) {
+				n += used[iRun];
+				sumContent += used[iRun] ? content[iRun] : 0.;
+				sumError += used[iRun] ? error[iRun] : 0.;
+			}
+			s.mNRuns = n;
+			s.mNIterations++;
+			s.mMeanContent = ( n > 0 ) ? sumContent / n : 0.;
+			s.mMeanError = ( n > 0 ) ? sumError / n : 0.;
+
+			Double_t sumDContent2 = 0, sumDError2 = 0;
+			for( Int_t iRun = 0; iRun < nRuns; iRun++ ) {
+				Double_t dContent = used[iRun] ? content[iRun] - s.mMeanContent : 0.;
+				Double_t dError = used[iRun] ? error[iRun] - s.mMeanError : 0.;
+				sumDContent2 += dContent * dContent;
+				sumDError2 += dError * dError;
+			}
+			s.mSigmaContent = ( n > 1 ) ? sqrt( sumDContent2 / (n-1) ) : 0.;
+			s.mSigmaError = ( n > 1 ) ? sqrt( sumDError2 / (n-1) ) : 0.;
+			if( n < 2 ) break;
+
+			Int_t nNew = 0;
+			for( Int_t iRun = 0; iRun < nRuns; iRun++ ) {
+				if( !used[iRun] ) continue;
+				if( TMath::Abs( content[iRun] - s.mMeanContent ) > 3*s.mSigmaContent ||
+					TMath::Abs( error[iRun] - s.mMeanError ) > 3*s.mSigmaError ) {
+					isBad[iRun] = 1;
+					used[iRun] = 0;
+					nNew++;
+				}
+			}
+			if( nNew == 0 ) break;
+		}
+		// Runs that are left after the last rejection
+		s.mNRuns = 0;
+		for( Int_t iRun = 0; iRun < nRuns; iRun++ ) s.mNRuns += used[iRun];
+	}
+}
+
+// Draw the profile before (left) and after (right) RunQA with the mean,
+// the 3 sigma band and the bad runs of this observable
+void DrawBadRuns( TProfile *tp, TProfile *tp1, const RunQAMatrix &matrix, Int_t iObs,
+				  const RunQAStats &stats, const std::vector<UChar_t> &flags,
+				  const Char_t *pathPics, const Char_t *format ) {
+
+	const Char_t *tprofile = matrix.mNames[iObs].c_str();
+	std::cout << "Drawing " << tprofile << std::endl;
+
+	Int_t nRuns = matrix.NRuns();
+	Double_t Mcontent = stats.mMeanContent, Merror = stats.mMeanError;
+	Double_t sigmaC = stats.mSigmaContent, sigmaErr = stats.mSigmaError;
+
+	std::vector<Float_t> badRun, badContent, badCErr, badRErr;   // arrays for graphics
+	for( Int_t iRun = 0; iRun < nRuns; iRun++ ) {
+		if( !flags[iObs * nRuns + iRun] ) continue;
+		badRun.push_back( matrix.mRunIds[iRun] );
+		badContent.push_back( matrix.mContent[iObs * nRuns + iRun] );
+		badCErr.push_back( matrix.mError[iObs * nRuns + iRun] );
+		badRErr.push_back( 0 );
+	}
+	Int_t b = badRun.size();
+
+	TCanvas *c1 = new TCanvas("c1", "c1", 1366, 768);
+	c1->Divide(2);
+	c1 -> cd(1);
+
+	tp -> SetStats(0);
+	tp -> SetMarkerStyle(20);
+	tp -> SetMarkerColor(kBlack);
+	tp -> SetAxisRange(Mcontent - 15*sigmaC,Mcontent + 15*sigmaC,"Y");
+	tp -> Draw();
+
+	TLegend *legC2_1 = new TLegend(0.54,0.7,0.89,.89);
+	legC2_1->AddEntry(tp,Form("Mean = %f",RoundValue(Mcontent) ),"");
+	legC2_1->AddEntry(tp,Form("Mean error = %f",RoundValue(Merror) ),"");
+	legC2_1->AddEntry(tp,Form("Sigma = %f", RoundValue(sigmaC) ),"");
+	legC2_1->AddEntry(tp,Form("Sigma error = %f", RoundValue(sigmaErr) ),"");
+	legC2_1->SetFillColor(kWhite);
+	legC2_1->SetBorderSize(0);
+	legC2_1->Draw();
+
+	Float_t x[2], mean[2];
+	x[0] = tp -> GetXaxis() -> GetXmin() - 1000, x[1] = tp -> GetXaxis() -> GetXmax() + 1000;
+	mean[0] = Mcontent, mean[1] = Mcontent;
+	TGraph *gmean = new TGraph(2,x,mean);  //paint calculated mean
+	gmean -> SetLineColor(kRed);
+	gmean -> SetLineWidth(2);
+	gmean -> Draw("CPsame");
+
+	Float_t sigmapos[2];
+	sigmapos[0] = Mcontent + 3*sigmaC, sigmapos[1] = Mcontent + 3*sigmaC;
+	TGraph *gsigmapos = new TGraph(2,x,sigmapos);  //paint top sigma
+	gsigmapos -> SetLineColor(kRed);
+	gsigmapos -> SetLineStyle(9);
+	gsigmapos -> SetLineWidth(2);
+	gsigmapos -> Draw("CPsame");
+
+	Float_t sigmaneg[2];
+	sigmaneg[0] = Mcontent - 3*sigmaC, sigmaneg[1] = Mcontent - 3*sigmaC;
+	TGraph *gsigmaneg = new TGraph(2,x,sigmaneg);  //paint down sigma
+	gsigmaneg -> SetLineColor(kRed);
+	gsigmaneg -> SetLineStyle(9);
+	gsigmaneg-> SetLineWidth(2);
+	gsigmaneg -> Draw("CPsame");
+
+	if( b > 0 ) {
+		TGraphErrors* gbaddot = new TGraphErrors(b,&badRun[0],&badContent[0],&badRErr[0],&badCErr[0]); //paint red dot for visualisation
+		gbaddot -> SetMarkerStyle(20);
 		gbaddot -> SetLineWidth(2);
 		gbaddot -> SetLineColor(kRed);
-		gbaddot -> SetMarkerColor(kRed); 
+		gbaddot -> SetMarkerColor(kRed);
 		gbaddot -> Draw("Psame");
-
-		TFile *f2 = new TFile(inFileRunQA,"READ");
-		c1 -> cd(2);
-		TProfile *tp1 = (TProfile*) f2 -> Get( tprofile );
-		tp1 -> SetStats(0);
-		tp1 -> SetMarkerStyle(20); 
-		tp1 -> SetMarkerColor(kBlack); 
-		tp1 -> SetAxisRange(Mcontent - 15*sigmaC,Mcontent + 15*sigmaC,"Y");
-		tp1 -> Draw();
-		gmean -> Draw("CPsame");
-		gsigmaneg -> Draw("CPsame");
-		gsigmapos -> Draw("CPsame");
-		c1->SaveAs( Form("%s%s.%s",pathPics,tprofile,format) );
 	}
-	
-	cout << "Done!" << endl; 
-	return BadRuns;
-}
 
+	c1 -> cd(2);
+	tp1 -> SetStats(0);
+	tp1 -> SetMarkerStyle(20);
+	tp1 -> SetMarkerColor(kBlack);
+	tp1 -> SetAxisRange(Mcontent - 15*sigmaC,Mcontent + 15*sigmaC,"Y");
+	tp1 -> Draw();
+	gmean -> Draw("CPsame");
+	gsigmaneg -> Draw("CPsame");
+	gsigmapos -> Draw("CPsame");
+	c1->SaveAs( Form("%s%s.%s",pathPics,tprofile,format) );
+	delete c1;
+}